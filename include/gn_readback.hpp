@@ -0,0 +1,43 @@
+#ifndef _GN_PERF_READBACK_HPP_
+#define _GN_PERF_READBACK_HPP_
+
+#include "gn_stream.hpp"
+
+// Asynchronous readback of rendered frames into a stream sink
+//
+// Frames are read into one of two pixel pack buffers. A frame is only mapped
+// and published when the next one has been queued, so the transfer overlaps
+// with the rendering of the next frame.
+class gn_readback
+{
+    struct slot
+    {
+        GLuint buffer;
+        size_t capacity;
+        bool pending;
+        uint64_t frame_index;
+        int width;
+        int height;
+    };
+
+    std::unique_ptr<gn_stream_sink> sink_;
+    gn_stream_format format_;
+    std::string identifier_;
+    slot slots_[2];
+    int current_;
+    bool failed_;
+
+    void publish(slot &s);
+
+public:
+    gn_readback(std::unique_ptr<gn_stream_sink> sink, gn_stream_format format, const std::string &identifier);
+    ~gn_readback();
+
+    // Queues the readback of the member output, and publishes the previous frame
+    void push(uint64_t frame_index, const std::shared_ptr<shadertoy::members::basic_member> &member, int width, int height);
+
+    // Publishes the frames still in flight
+    void flush();
+};
+
+#endif /* _GN_PERF_READBACK_HPP_ */
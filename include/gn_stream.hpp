@@ -0,0 +1,91 @@
+#ifndef _GN_PERF_STREAM_HPP_
+#define _GN_PERF_STREAM_HPP_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+// Layout of the streamed frames, shared by gn_perf and the stream readers
+//
+// A shared-memory stream is a gn_stream_ring header, followed by slot_count
+// slots of slot_stride bytes. Each slot is a gn_stream_frame header followed
+// by the pixel data. Slots are protected by a sequence lock: the writer makes
+// seq odd while the slot is being written, readers must check that seq is
+// even and did not change while they were copying the frame.
+//
+// Each writer creates a new shared memory object, replacing any previous one
+// under the same name. It does so again when a frame outgrows the slots, so
+// readers must re-attach when the object behind the name changes.
+//
+// A pipe stream is a sequence of gn_stream_frame headers, each immediately
+// followed by its pixel data. The seq field is then always 0.
+
+#define GN_STREAM_MAGIC "GNSTREAM"
+#define GN_STREAM_VERSION 2
+
+enum gn_stream_format : uint32_t
+{
+    // 4 x 8-bit unsigned normalized
+    GN_STREAM_RGBA8 = 1,
+    // 4 x 32-bit float
+    GN_STREAM_RGBA32F = 2,
+};
+
+struct gn_stream_frame
+{
+    std::atomic<uint64_t> seq;
+    uint64_t frame_index;
+    uint64_t size;
+    uint32_t width;
+    uint32_t height;
+    uint32_t format;
+    uint32_t reserved;
+    // Hex SHA-256 of the shader sources, see gn_perf_ctx::identifier
+    char identifier[72];
+};
+
+// Pixel data following a frame header in a shared-memory slot
+inline char *gn_stream_data(gn_stream_frame *frame)
+{ return reinterpret_cast<char *>(frame + 1); }
+
+inline const char *gn_stream_data(const gn_stream_frame *frame)
+{ return reinterpret_cast<const char *>(frame + 1); }
+
+// Padded so the slots that follow it are cache-line aligned
+struct alignas(64) gn_stream_ring
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t slot_count;
+    uint64_t slot_stride;
+    // Number of frames published so far, the latest one is in slot
+    // (write_count - 1) % slot_count
+    std::atomic<uint64_t> write_count;
+};
+
+static_assert(ATOMIC_LLONG_LOCK_FREE == 2, "shared-memory streams require lock-free 64-bit atomics");
+
+// Size in bytes of one pixel in the given format, 0 if unknown
+size_t gn_stream_pixel_size(uint32_t format);
+
+// Parses a format name (rgba8, rgba32f)
+gn_stream_format gn_stream_parse_format(const std::string &name);
+
+// Destination of the streamed frames
+class gn_stream_sink
+{
+public:
+    virtual ~gn_stream_sink() = default;
+
+    // Publishes a frame. frame.seq is ignored. Returns false if the frame
+    // could not be published.
+    virtual bool publish(const gn_stream_frame &frame, const void *pixels) = 0;
+
+    // Creates a sink from a specification: shm:/name or pipe:path. The
+    // shared memory slots are initially sized for frame_size bytes.
+    static std::unique_ptr<gn_stream_sink> create(const std::string &spec, size_t frame_size, int slot_count);
+};
+
+#endif /* _GN_PERF_STREAM_HPP_ */
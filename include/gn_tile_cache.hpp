@@ -0,0 +1,122 @@
+#ifndef _GN_PERF_TILE_CACHE_HPP_
+#define _GN_PERF_TILE_CACHE_HPP_
+
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Identifies a rendered tile of the noise field
+struct gn_tile_key
+{
+    // Tile coordinates, in tiles of the given level
+    int64_t x;
+    int64_t y;
+    // Zoom level, a tile covers 2^level noise pixels per tile pixel
+    int level;
+    // Hash of the shader identifier, which covers a constant RANDOM_SEED.
+    // Tiles rendered with a per-frame seed are never cached.
+    size_t shader;
+
+    bool operator==(const gn_tile_key &other) const
+    {
+        return x == other.x && y == other.y && level == other.level &&
+            shader == other.shader;
+    }
+};
+
+struct gn_tile_key_hash
+{
+    size_t operator()(const gn_tile_key &key) const;
+};
+
+// LRU cache of tile textures
+class gn_tile_cache
+{
+    struct entry
+    {
+        gn_tile_key key;
+        GLuint texture;
+    };
+
+    int tile_size_;
+    size_t capacity_;
+    std::list<entry> entries_;
+    std::unordered_map<gn_tile_key, std::list<entry>::iterator, gn_tile_key_hash> index_;
+
+public:
+    gn_tile_cache(int tile_size, size_t capacity_bytes);
+    ~gn_tile_cache();
+
+    inline int tile_size() const
+    { return tile_size_; }
+
+    // Size in bytes of a cached tile
+    size_t tile_bytes() const;
+
+    // Memory used by the cached tiles, in bytes
+    inline size_t memory_used() const
+    { return entries_.size() * tile_bytes(); }
+
+    // Texture of a cached tile, marked as most recently used. 0 if the
+    // tile is not in the cache.
+    GLuint find(const gn_tile_key &key);
+
+    // Texture to store a new tile into, recycled from the least recently
+    // used tile when the cache is full
+    GLuint insert(const gn_tile_key &key);
+};
+
+struct gn_perf_ctx;
+
+// Renders a viewport of the noise field from cached tiles
+//
+// Tiles are rendered by a separate chain compiled with VIEWPORT, at the tile
+// size, and only when they are not in the cache. When RANDOM_SEED is not an
+// integer constant, it is assumed to change every frame (e.g. iFrame or
+// iTime) and tiles are rendered without going through the cache.
+class gn_tile_renderer
+{
+    std::unique_ptr<gn_perf_ctx> tile_ctx_;
+    gn_tile_cache cache_;
+    size_t shader_;
+    bool dynamic_;
+    double period_x_;
+    double period_y_;
+    GLuint scratch_;
+    GLuint read_fbo_;
+    GLuint timestamps_[2];
+
+public:
+    // Statistics of the last rendered frame
+    int hits;
+    int misses;
+    // GPU time of the whole frame, tile evaluation and composition, in
+    // nanoseconds
+    uint64_t elapsed_time;
+
+    gn_tile_renderer(int width, int height, std::vector<std::string> defines, const std::string &lut_path,
+                     int tile_size, size_t cache_bytes);
+    ~gn_tile_renderer();
+
+    inline const gn_tile_cache &cache() const
+    { return cache_; }
+
+    // Whether the tiles depend on the frame, and bypass the cache
+    inline bool dynamic() const
+    { return dynamic_; }
+
+    // Wraps a viewport origin into the period of the noise field, so it
+    // stays small enough for the float uniforms. Clamps it at 0 if the
+    // period cannot be derived from the definitions.
+    void wrap(double &x, double &y) const;
+
+    // Renders to the default framebuffer the viewport of size width x
+    // height, whose origin is at (x, y) noise pixels, at the given level.
+    // frame and time are the iFrame and iTime uniforms.
+    void render(double x, double y, int level, int width, int height, int frame, double time);
+};
+
+#endif /* _GN_PERF_TILE_CACHE_HPP_ */
@@ -1,7 +1,24 @@
 #define M_PI 3.141592653589793
 #define W0VEC(w0) vec2(cos(w0), sin(w0))
 
+#if defined(LOD_SCALE) || defined(VIEWPORT)
+// Rendering a minified level implies prefiltering
+#ifndef LOD
+#define LOD
+#ifdef VIEWPORT
+// Viewports are only prefiltered when zoomed out, so they match the regular
+// rendering otherwise
+#define LOD_MINIFIED_ONLY
+#endif /* VIEWPORT */
+#endif /* LOD */
+#endif /* LOD_SCALE || VIEWPORT */
+
+#ifdef LOD_SCALE
+// Resolution of the full-scale noise this level is a minification of
+#define RESOLUTION ivec2(vec2(WIDTH, HEIGHT) * float(LOD_SCALE))
+#else
 #define RESOLUTION ivec2(WIDTH, HEIGHT)
+#endif /* LOD_SCALE */
 #define TILE_COUNT (RESOLUTION / _TILE_SIZE)
 
 #define WEIGHTS_UNIFORM 0
@@ -47,6 +64,21 @@
 #define _TILE_SIZE TILE_SIZE
 #endif
 
+// Kernel radius, in pixels
+#ifdef KHALF
+#define _KERNEL_SIZE (_TILE_SIZE / 2)
+#else
+#define _KERNEL_SIZE _TILE_SIZE
+#endif /* KHALF */
+
+#ifndef LOD_SIGMA
+#define LOD_SIGMA .5
+#endif
+
+#ifndef LOD_CUTOFF
+#define LOD_CUTOFF 1e-3
+#endif
+
 #ifndef DISP_SIZE
 #define DISP_SIZE 1
 #endif
@@ -109,14 +141,7 @@ float h(vec2 x, float phase) {
 #else
         cos
 #endif /* KSIN */
-        (2. * M_PI * F0 *
-         dot(x /
-#ifdef KHALF
-             (_TILE_SIZE / 2)
-#else
-             _TILE_SIZE
-#endif /* KHALF */
-             , W0VEC(w0)) + phase);
+        (2. * M_PI * F0 * dot(x / _KERNEL_SIZE, W0VEC(w0)) + phase);
 
 #ifdef KSHOW
     return eb > 0. ? .5 : 0.;
@@ -551,8 +576,45 @@ void pg_point(inout point_gen_state this_, out vec4 pt)
 
 #endif /* POINTS */
 
+#ifdef LOD
+// Attenuation of the kernel wave for a pixel footprint of the given size
+//
+// The pixel filter is approximated by a Gaussian of standard deviation
+// LOD_SIGMA * footprint. Convolving the cosine carrier of frequency f with
+// it scales its amplitude by exp(-2 pi^2 sigma^2 f^2). The broadening of the
+// (truncated) envelope is neglected.
+float lod_attenuation(float footprint)
+{
+    // Spatial frequency of the kernel, in cycles per pixel. This matches the
+    // scaling applied in h(), where each axis of the relative location is
+    // divided twice by the kernel size.
+    vec2 ks = vec2(_KERNEL_SIZE);
+#ifdef PRESET_BOOT
+    // The orientation varies per splat, use the lowest possible frequency so
+    // the cutoff never drops visible content
+    float freq = float(F0) / max(ks.x * ks.x, ks.y * ks.y);
+#else
+    float freq = float(F0) * length(W0VEC(W0) / (ks * ks));
+#endif /* PRESET_BOOT */
+
+    float sigma = LOD_SIGMA * footprint;
+    return exp(-2. * M_PI * M_PI * sigma * sigma * freq * freq);
+}
+#endif /* LOD */
+
 void mainImage(out vec4 O, in vec2 U)
 {
+#ifdef LOD_SCALE
+    // Evaluate the full-scale noise at this minified pixel
+    U *= float(LOD_SCALE);
+#endif /* LOD_SCALE */
+
+#ifdef VIEWPORT
+    // Window on the noise field: iMouse.xy is the origin and iMouse.z the
+    // scale, in noise pixels
+    U = iMouse.xy + U * iMouse.z;
+#endif /* VIEWPORT */
+
     ivec2 ccell = ivec2(U / _TILE_SIZE);
     vec2 ccenter = _TILE_SIZE * (vec2(ccell) + .5);
     ivec2 disp;
@@ -560,6 +622,32 @@ void mainImage(out vec4 O, in vec2 U)
     // Initial return value
     O = vec4(0.);
 
+#if defined(LOD) && !defined(KSHOW)
+    // Per-pixel footprint, from the screen-space derivatives of the
+    // evaluation coordinates (LOD_SCALE when rendering a minified level)
+    float lod_footprint = max(length(dFdx(U)), length(dFdy(U)));
+#ifdef LOD_MINIFIED_ONLY
+    float lod_atten = lod_footprint > 1. ? lod_attenuation(lod_footprint) : 1.;
+#else
+    float lod_atten = lod_attenuation(lod_footprint);
+#endif /* LOD_MINIFIED_ONLY */
+
+    // All splats share the same frequency magnitude, so if the carrier is
+    // filtered out for one it is filtered out for all of them: skip the
+    // splat evaluation and return the mean value. With PRESET_BOOT and a
+    // non-square kernel the magnitude depends on the orientation; the
+    // attenuation then uses the lowest one, which keeps the cutoff safe but
+    // under-attenuates the other orientations.
+    if (lod_atten < LOD_CUTOFF)
+    {
+        O = vec4(.5);
+#ifdef ENABLE_LUT
+        O = texture(iChannel0, vec2(O.x, .5));
+#endif
+        return;
+    }
+#endif /* LOD && !KSHOW */
+
 #ifdef KHALF
     for (disp.x = (U.x < ccenter.x ? -DISP_SIZE : 0); disp.x <= (U.x > ccenter.x ? DISP_SIZE : 0); ++disp.x)
         for (disp.y = (U.y < ccenter.y ? -DISP_SIZE : 0); disp.y <= (U.y > ccenter.y ? DISP_SIZE : 0); ++disp.y)
@@ -590,19 +678,17 @@ void mainImage(out vec4 O, in vec2 U)
                 props.xy = center + _TILE_SIZE / 2 * props.xy;
 
                 // Compute relative location
-                props.xy = (U - props.xy) /
-#ifdef KHALF
-                    (_TILE_SIZE / 2)
-#else
-                    _TILE_SIZE
-#endif /* KHALF */
-                ;
+                props.xy = (U - props.xy) / _KERNEL_SIZE;
 
                 // Compute contribution
                 O += props.z * h(props.xy, props.w);
             }
         }
 
+#if defined(LOD) && !defined(KSHOW)
+    O *= lod_atten;
+#endif /* LOD && !KSHOW */
+
     // [0, 1] range
     O = .5 + .5 * O /
 #ifdef KHALF
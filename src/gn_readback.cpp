@@ -0,0 +1,116 @@
+#include <epoxy/gl.h>
+
+#include <cassert>
+#include <cstring>
+
+#include <shadertoy.hpp>
+#include <shadertoy/utils/log.hpp>
+
+#include "gn_readback.hpp"
+
+using shadertoy::utils::log;
+using shadertoy::gl::gl_call;
+
+static GLenum gl_type(gn_stream_format format)
+{
+    return format == GN_STREAM_RGBA8 ? GL_UNSIGNED_BYTE : GL_FLOAT;
+}
+
+gn_readback::gn_readback(std::unique_ptr<gn_stream_sink> sink, gn_stream_format format, const std::string &identifier)
+    : sink_(std::move(sink)),
+    format_(format),
+    identifier_(identifier),
+    slots_(),
+    current_(0),
+    failed_(false)
+{
+    for (auto &s : slots_)
+        gl_call(glGenBuffers, 1, &s.buffer);
+}
+
+gn_readback::~gn_readback()
+{
+    for (auto &s : slots_)
+        glDeleteBuffers(1, &s.buffer);
+}
+
+void gn_readback::publish(slot &s)
+{
+    if (!s.pending)
+        return;
+
+    s.pending = false;
+
+    if (failed_)
+        return;
+
+    gn_stream_frame frame{};
+    frame.frame_index = s.frame_index;
+    frame.size = gn_stream_pixel_size(format_) * s.width * s.height;
+    frame.width = s.width;
+    frame.height = s.height;
+    frame.format = format_;
+    strncpy(frame.identifier, identifier_.c_str(), sizeof(frame.identifier) - 1);
+
+    // Waits for the transfer to complete, if it has not already
+    gl_call(glBindBuffer, GL_PIXEL_PACK_BUFFER, s.buffer);
+    auto pixels = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, frame.size, GL_MAP_READ_BIT);
+
+    if (!pixels)
+    {
+        log::shadertoy()->warn("Failed to map readback buffer for frame {}", s.frame_index);
+    }
+    else
+    {
+        if (!sink_->publish(frame, pixels))
+        {
+            log::shadertoy()->warn("Failed to publish frame {}, streaming stopped", s.frame_index);
+            failed_ = true;
+        }
+
+        gl_call(glUnmapBuffer, GL_PIXEL_PACK_BUFFER);
+    }
+
+    gl_call(glBindBuffer, GL_PIXEL_PACK_BUFFER, 0);
+}
+
+void gn_readback::push(uint64_t frame_index, const std::shared_ptr<shadertoy::members::basic_member> &member, int width, int height)
+{
+    if (failed_)
+        return;
+
+    auto &s(slots_[current_]);
+    size_t size = gn_stream_pixel_size(format_) * width * height;
+
+    gl_call(glBindBuffer, GL_PIXEL_PACK_BUFFER, s.buffer);
+
+    // Reallocate on resize
+    if (s.capacity < size)
+    {
+        gl_call(glBufferData, GL_PIXEL_PACK_BUFFER, size, nullptr, GL_STREAM_READ);
+        s.capacity = size;
+    }
+
+    // With a pack buffer bound, this only queues the transfer
+    auto texture = member->output();
+    assert(texture);
+    texture->get_image(0, GL_RGBA, gl_type(format_), size, nullptr);
+
+    gl_call(glBindBuffer, GL_PIXEL_PACK_BUFFER, 0);
+
+    s.pending = true;
+    s.frame_index = frame_index;
+    s.width = width;
+    s.height = height;
+
+    // Publish the previous frame while this one is in flight
+    current_ ^= 1;
+    publish(slots_[current_]);
+}
+
+void gn_readback::flush()
+{
+    // Oldest frame first
+    publish(slots_[current_]);
+    publish(slots_[current_ ^ 1]);
+}
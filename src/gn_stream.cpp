@@ -0,0 +1,249 @@
+#include <cerrno>
+#include <cstring>
+#include <new>
+#include <stdexcept>
+#include <sstream>
+
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "gn_stream.hpp"
+
+size_t gn_stream_pixel_size(uint32_t format)
+{
+    switch (format)
+    {
+        case GN_STREAM_RGBA8:
+            return 4 * sizeof(uint8_t);
+        case GN_STREAM_RGBA32F:
+            return 4 * sizeof(float);
+        default:
+            return 0;
+    }
+}
+
+gn_stream_format gn_stream_parse_format(const std::string &name)
+{
+    if (name == "rgba8")
+        return GN_STREAM_RGBA8;
+    if (name == "rgba32f")
+        return GN_STREAM_RGBA32F;
+
+    throw std::runtime_error("Unknown stream format " + name);
+}
+
+static std::runtime_error errno_error(const std::string &what, const std::string &path)
+{
+    std::stringstream ss;
+    ss << what << " " << path << ": " << strerror(errno);
+    return std::runtime_error(ss.str());
+}
+
+// Ring buffer of frames in a POSIX shared memory object
+class gn_stream_shm_sink : public gn_stream_sink
+{
+    std::string name_;
+    int slot_count_;
+    void *map_;
+    size_t map_size_;
+    gn_stream_ring *ring_;
+    size_t max_frame_size_;
+
+    gn_stream_frame *slot(uint64_t index)
+    {
+        auto base = reinterpret_cast<char *>(ring_ + 1);
+        return reinterpret_cast<gn_stream_frame *>(base + (index % ring_->slot_count) * ring_->slot_stride);
+    }
+
+    void unmap()
+    {
+        if (map_ != MAP_FAILED)
+            munmap(map_, map_size_);
+
+        map_ = MAP_FAILED;
+        ring_ = nullptr;
+    }
+
+    // Creates a new ring, replacing the existing object, if any. Readers
+    // that are still attached to it keep their mapping.
+    void create_ring(size_t max_frame_size)
+    {
+        unmap();
+
+        // Slots are cache-line aligned, since the ring header is
+        size_t slot_stride = (sizeof(gn_stream_frame) + max_frame_size + 63) & ~size_t(63);
+        map_size_ = sizeof(gn_stream_ring) + slot_count_ * slot_stride;
+        max_frame_size_ = slot_stride - sizeof(gn_stream_frame);
+
+        // Never reuse a ring left behind by another writer
+        shm_unlink(name_.c_str());
+
+        int fd = shm_open(name_.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+        if (fd < 0)
+            throw errno_error("Failed to create shared memory", name_);
+
+        if (ftruncate(fd, map_size_) != 0)
+        {
+            auto err = errno_error("Failed to size shared memory", name_);
+            close(fd);
+            shm_unlink(name_.c_str());
+            throw err;
+        }
+
+        map_ = mmap(nullptr, map_size_, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        close(fd);
+
+        if (map_ == MAP_FAILED)
+        {
+            auto err = errno_error("Failed to map shared memory", name_);
+            shm_unlink(name_.c_str());
+            throw err;
+        }
+
+        // Readers wait for the magic, which is written last, so they never
+        // see a half-initialized ring
+        ring_ = new (map_) gn_stream_ring;
+        memset(ring_->magic, 0, sizeof(ring_->magic));
+        ring_->version = GN_STREAM_VERSION;
+        ring_->slot_count = slot_count_;
+        ring_->slot_stride = slot_stride;
+        ring_->write_count.store(0);
+
+        for (int i = 0; i < slot_count_; ++i)
+            new (slot(i)) gn_stream_frame{};
+
+        std::atomic_thread_fence(std::memory_order_release);
+        memcpy(ring_->magic, GN_STREAM_MAGIC, sizeof(ring_->magic));
+    }
+
+public:
+    gn_stream_shm_sink(const std::string &name, size_t frame_size, int slot_count)
+        : name_(name),
+        slot_count_(slot_count),
+        map_(MAP_FAILED),
+        map_size_(0),
+        ring_(nullptr),
+        max_frame_size_(0)
+    {
+        if (slot_count < 1)
+            throw std::runtime_error("Stream slot count must be positive");
+
+        create_ring(frame_size);
+    }
+
+    ~gn_stream_shm_sink()
+    {
+        unmap();
+        shm_unlink(name_.c_str());
+    }
+
+    bool publish(const gn_stream_frame &frame, const void *pixels) override
+    {
+        // Grow the slots when the framebuffer was resized
+        if (frame.size > max_frame_size_)
+        {
+            try
+            {
+                create_ring(frame.size);
+            }
+            catch (const std::runtime_error &)
+            {
+                return false;
+            }
+        }
+
+        uint64_t count = ring_->write_count.load(std::memory_order_relaxed);
+        gn_stream_frame *dst = slot(count);
+
+        // Sequence lock: odd while writing
+        uint64_t seq = dst->seq.load(std::memory_order_relaxed);
+        dst->seq.store(seq + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+
+        dst->frame_index = frame.frame_index;
+        dst->size = frame.size;
+        dst->width = frame.width;
+        dst->height = frame.height;
+        dst->format = frame.format;
+        memcpy(dst->identifier, frame.identifier, sizeof(dst->identifier));
+        memcpy(gn_stream_data(dst), pixels, frame.size);
+
+        dst->seq.store(seq + 2, std::memory_order_release);
+        ring_->write_count.store(count + 1, std::memory_order_release);
+        return true;
+    }
+};
+
+// Raw frames written to a pipe or file
+class gn_stream_pipe_sink : public gn_stream_sink
+{
+    std::string path_;
+    int fd_;
+
+    bool write_all(const void *data, size_t size)
+    {
+        auto p = static_cast<const char *>(data);
+        while (size > 0)
+        {
+            ssize_t n = write(fd_, p, size);
+            if (n < 0)
+            {
+                if (errno == EINTR)
+                    continue;
+                return false;
+            }
+
+            p += n;
+            size -= n;
+        }
+
+        return true;
+    }
+
+public:
+    gn_stream_pipe_sink(const std::string &path)
+        : path_(path),
+        fd_(-1)
+    {
+        // A reader going away must not kill the renderer
+        signal(SIGPIPE, SIG_IGN);
+
+        // Blocks until a reader opens the FIFO, drops the frames of a
+        // previous run from a regular file
+        fd_ = open(path_.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd_ < 0)
+            throw errno_error("Failed to open stream pipe", path_);
+    }
+
+    ~gn_stream_pipe_sink()
+    {
+        if (fd_ >= 0)
+            close(fd_);
+    }
+
+    bool publish(const gn_stream_frame &frame, const void *pixels) override
+    {
+        gn_stream_frame header{};
+        header.frame_index = frame.frame_index;
+        header.size = frame.size;
+        header.width = frame.width;
+        header.height = frame.height;
+        header.format = frame.format;
+        memcpy(header.identifier, frame.identifier, sizeof(header.identifier));
+
+        return write_all(&header, sizeof(header)) && write_all(pixels, frame.size);
+    }
+};
+
+std::unique_ptr<gn_stream_sink> gn_stream_sink::create(const std::string &spec, size_t frame_size, int slot_count)
+{
+    if (spec.compare(0, 4, "shm:") == 0)
+        return std::make_unique<gn_stream_shm_sink>(spec.substr(4), frame_size, slot_count);
+    if (spec.compare(0, 5, "pipe:") == 0)
+        return std::make_unique<gn_stream_pipe_sink>(spec.substr(5));
+
+    throw std::runtime_error("Invalid stream specification " + spec + ", expected shm:/name or pipe:path");
+}
@@ -0,0 +1,373 @@
+#include <boost/program_options.hpp>
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "gn_stream.hpp"
+
+namespace po = boost::program_options;
+using clock_type = std::chrono::steady_clock;
+
+static const char *format_name(uint32_t format)
+{
+    switch (format)
+    {
+        case GN_STREAM_RGBA8:
+            return "rgba8";
+        case GN_STREAM_RGBA32F:
+            return "rgba32f";
+        default:
+            return "unknown";
+    }
+}
+
+// Largest frame accepted from a pipe, 16k x 16k rgba32f
+static const uint64_t max_pipe_frame_size = uint64_t(16384) * 16384 * 4 * sizeof(float);
+
+// Whether the frame header is consistent, and its pixels fit in max_size bytes
+static bool frame_valid(const gn_stream_frame &frame, uint64_t max_size)
+{
+    auto pixel_size = gn_stream_pixel_size(frame.format);
+    return pixel_size != 0 &&
+        frame.size == uint64_t(pixel_size) * frame.width * frame.height &&
+        frame.size <= max_size;
+}
+
+// Mean of the first channel, as a cheap check that the pixels made it through
+static double frame_mean(const gn_stream_frame &frame, const char *pixels)
+{
+    size_t count = size_t(frame.width) * frame.height;
+    double sum = 0.;
+
+    if (count == 0)
+        return 0.;
+
+    for (size_t i = 0; i < count; ++i)
+    {
+        if (frame.format == GN_STREAM_RGBA8)
+            sum += reinterpret_cast<const uint8_t *>(pixels)[4 * i] / 255.;
+        else if (frame.format == GN_STREAM_RGBA32F)
+            sum += reinterpret_cast<const float *>(pixels)[4 * i];
+    }
+
+    return sum / count;
+}
+
+static void print_frame(const gn_stream_frame &frame, const char *pixels)
+{
+    printf("%8llu\t%10llu\t%4u\t%4u\t%8s\t%8.4lf\t%.*s\n",
+           static_cast<unsigned long long>(frame.frame_index),
+           static_cast<unsigned long long>(frame.size),
+           frame.width,
+           frame.height,
+           format_name(frame.format),
+           frame_mean(frame, pixels),
+           static_cast<int>(strnlen(frame.identifier, sizeof(frame.identifier))),
+           frame.identifier);
+    fflush(stdout);
+}
+
+// Mapping of a shared memory ring
+struct shm_ring
+{
+    void *map;
+    size_t size;
+    ino_t ino;
+
+    const gn_stream_ring *ring() const
+    { return static_cast<const gn_stream_ring *>(map); }
+
+    const gn_stream_frame *slot(uint64_t index) const
+    {
+        auto base = reinterpret_cast<const char *>(ring() + 1);
+        return reinterpret_cast<const gn_stream_frame *>(base + (index % ring()->slot_count) * ring()->slot_stride);
+    }
+};
+
+static void detach(shm_ring &r)
+{
+    if (r.map != MAP_FAILED)
+        munmap(r.map, r.size);
+    r.map = MAP_FAILED;
+}
+
+// Attaches to the ring, waiting for the writer to create and initialize it
+static bool attach(const std::string &name, shm_ring &r, clock_type::time_point deadline)
+{
+    detach(r);
+
+    for (;;)
+    {
+        int fd = shm_open(name.c_str(), O_RDONLY, 0);
+        if (fd >= 0)
+        {
+            struct stat st;
+            if (fstat(fd, &st) == 0 && static_cast<size_t>(st.st_size) >= sizeof(gn_stream_ring))
+            {
+                void *map = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+                if (map != MAP_FAILED)
+                {
+                    // The magic is written last by the writer
+                    auto ring = static_cast<const gn_stream_ring *>(map);
+                    bool ready = memcmp(ring->magic, GN_STREAM_MAGIC, sizeof(ring->magic)) == 0;
+                    std::atomic_thread_fence(std::memory_order_acquire);
+
+                    if (ready && ring->version == GN_STREAM_VERSION &&
+                        ring->slot_stride >= sizeof(gn_stream_frame) &&
+                        sizeof(gn_stream_ring) + ring->slot_count * ring->slot_stride <= static_cast<size_t>(st.st_size))
+                    {
+                        close(fd);
+                        r.map = map;
+                        r.size = st.st_size;
+                        r.ino = st.st_ino;
+                        return true;
+                    }
+
+                    munmap(map, st.st_size);
+                }
+            }
+
+            close(fd);
+        }
+
+        if (clock_type::now() > deadline)
+        {
+            std::cerr << "Failed to attach to shared memory " << name << std::endl;
+            return false;
+        }
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+}
+
+// Whether the name now refers to another ring than the attached one, which
+// happens when a new writer starts or the frames outgrow the slots
+static bool replaced(const std::string &name, const shm_ring &r)
+{
+    int fd = shm_open(name.c_str(), O_RDONLY, 0);
+    if (fd < 0)
+        return false;
+
+    struct stat st;
+    bool result = fstat(fd, &st) == 0 && st.st_ino != r.ino;
+    close(fd);
+    return result;
+}
+
+static int read_shm(const std::string &name, long long count, double timeout)
+{
+    auto timeout_d = std::chrono::duration_cast<clock_type::duration>(std::chrono::duration<double>(timeout));
+    shm_ring r{MAP_FAILED, 0, 0};
+
+    if (!attach(name, r, clock_type::now() + timeout_d))
+        return 1;
+
+    std::vector<char> pixels;
+    long long received = 0, dropped = 0;
+    auto deadline = clock_type::now() + timeout_d;
+
+    // Read the whole ring, frames older than that have been overwritten
+    auto first_frame = [&]()
+    {
+        uint64_t written = r.ring()->write_count.load(std::memory_order_acquire);
+        uint64_t first = written > r.ring()->slot_count ? written - r.ring()->slot_count : 0;
+        dropped += first;
+        pixels.resize(r.ring()->slot_stride);
+        return first;
+    };
+
+    uint64_t next = first_frame();
+
+    while (count <= 0 || received < count)
+    {
+        uint64_t written = r.ring()->write_count.load(std::memory_order_acquire);
+
+        if (written == next)
+        {
+            if (replaced(name, r))
+            {
+                std::cerr << "Stream " << name << " was replaced, re-attaching" << std::endl;
+                if (!attach(name, r, clock_type::now() + timeout_d))
+                    break;
+
+                next = first_frame();
+                deadline = clock_type::now() + timeout_d;
+                continue;
+            }
+
+            if (clock_type::now() > deadline)
+                break;
+
+            std::this_thread::sleep_for(std::chrono::microseconds(500));
+            continue;
+        }
+
+        // Should not happen with a single writer per ring, start over
+        if (written < next)
+        {
+            next = first_frame();
+            continue;
+        }
+
+        // Frames older than the ring size have been overwritten
+        if (written - next > r.ring()->slot_count)
+        {
+            dropped += written - next - r.ring()->slot_count;
+            next = written - r.ring()->slot_count;
+        }
+
+        auto slot = r.slot(next);
+
+        // Sequence lock, the frame is dropped if the slot was overwritten
+        // while copying it
+        uint64_t seq = slot->seq.load(std::memory_order_acquire);
+        uint64_t capacity = r.ring()->slot_stride - sizeof(gn_stream_frame);
+        gn_stream_frame frame{};
+        frame.frame_index = slot->frame_index;
+        frame.size = slot->size;
+        frame.width = slot->width;
+        frame.height = slot->height;
+        frame.format = slot->format;
+        memcpy(frame.identifier, slot->identifier, sizeof(frame.identifier));
+        memcpy(pixels.data(), gn_stream_data(slot), std::min(frame.size, capacity));
+        std::atomic_thread_fence(std::memory_order_acquire);
+
+        if ((seq & 1) != 0 || slot->seq.load(std::memory_order_relaxed) != seq)
+        {
+            dropped++;
+            next++;
+            continue;
+        }
+
+        if (!frame_valid(frame, capacity))
+        {
+            std::cerr << "Corrupt frame " << frame.frame_index << ", dropped" << std::endl;
+            dropped++;
+            next++;
+            continue;
+        }
+
+        print_frame(frame, pixels.data());
+        received++;
+        next++;
+        deadline = clock_type::now() + timeout_d;
+    }
+
+    std::cerr << "Received " << received << " frames, dropped " << dropped << std::endl;
+    detach(r);
+    return 0;
+}
+
+static bool read_all(int fd, void *data, size_t size)
+{
+    auto p = static_cast<char *>(data);
+    while (size > 0)
+    {
+        ssize_t n = read(fd, p, size);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return false;
+
+        p += n;
+        size -= n;
+    }
+
+    return true;
+}
+
+static int read_pipe(const std::string &path, long long count)
+{
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+        std::cerr << "Failed to open stream pipe " << path << ": " << strerror(errno) << std::endl;
+        return 1;
+    }
+
+    std::vector<char> pixels;
+    long long received = 0;
+    gn_stream_frame frame{};
+    int result = 0;
+
+    while ((count <= 0 || received < count) && read_all(fd, &frame, sizeof(frame)))
+    {
+        // Frames are not delimited, there is no way to resynchronize
+        if (!frame_valid(frame, max_pipe_frame_size))
+        {
+            std::cerr << "Corrupt stream at frame " << received << std::endl;
+            result = 1;
+            break;
+        }
+
+        pixels.resize(frame.size);
+        if (!read_all(fd, pixels.data(), frame.size))
+        {
+            std::cerr << "Truncated frame " << frame.frame_index << std::endl;
+            break;
+        }
+
+        print_frame(frame, pixels.data());
+        received++;
+    }
+
+    std::cerr << "Received " << received << " frames" << std::endl;
+    close(fd);
+    return result;
+}
+
+int main(int argc, char *argv[])
+{
+    std::string source;
+    long long count;
+    double timeout;
+
+    po::options_description desc("gn-stream-read: reads frames streamed by gn_perf --stream");
+    desc.add_options()
+        ("source", po::value(&source), "Stream to read from, shm:/name or pipe:path")
+        ("count,n", po::value(&count)->default_value(0), "Number of frames to read (0 for all)")
+        ("timeout,t", po::value(&timeout)->default_value(5.), "Seconds to wait for a shared memory frame before exiting")
+        ("help,h", "Show this help message");
+
+    po::positional_options_description po_desc;
+    po_desc.add("source", 1);
+
+    po::variables_map vm;
+
+    try
+    {
+        po::store(po::command_line_parser(argc, argv).options(desc).positional(po_desc).run(), vm);
+        po::notify(vm);
+    }
+    catch (const po::error &ex)
+    {
+        std::cerr << ex.what() << std::endl;
+        std::cerr << "See --help option for usage" << std::endl;
+        return 1;
+    }
+
+    if (vm.count("help") || source.empty())
+    {
+        std::cout << desc << std::endl;
+        return vm.count("help") ? 0 : 1;
+    }
+
+    printf("%8s\t%10s\t%4s\t%4s\t%8s\t%8s\t%s\n", "frame", "size", "wh_px", "ch_px", "format", "mean", "identifier");
+
+    if (source.compare(0, 4, "shm:") == 0)
+        return read_shm(source.substr(4), count, timeout);
+    if (source.compare(0, 5, "pipe:") == 0)
+        return read_pipe(source.substr(5), count);
+
+    std::cerr << "Invalid stream specification " << source << ", expected shm:/name or pipe:path" << std::endl;
+    return 1;
+}
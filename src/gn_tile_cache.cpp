@@ -0,0 +1,281 @@
+#include <epoxy/gl.h>
+#include <GLFW/glfw3.h>
+
+#include <algorithm>
+#include <cassert>
+#include <cerrno>
+#include <cmath>
+#include <cstdlib>
+#include <functional>
+
+#include <shadertoy.hpp>
+#include <shadertoy/utils/log.hpp>
+
+#include "gn_glfw.hpp"
+#include "gn_tile_cache.hpp"
+
+using shadertoy::utils::log;
+using shadertoy::gl::gl_call;
+
+size_t gn_tile_key_hash::operator()(const gn_tile_key &key) const
+{
+    size_t h = key.shader;
+    for (auto v : { uint64_t(key.x), uint64_t(key.y), uint64_t(key.level) })
+        h ^= std::hash<uint64_t>()(v) + 0x9e3779b97f4a7c15ull + (h << 6) + (h >> 2);
+    return h;
+}
+
+gn_tile_cache::gn_tile_cache(int tile_size, size_t capacity_bytes)
+    : tile_size_(tile_size),
+    capacity_(std::max<size_t>(1, capacity_bytes / tile_bytes())),
+    entries_(),
+    index_()
+{
+}
+
+gn_tile_cache::~gn_tile_cache()
+{
+    for (auto &e : entries_)
+        glDeleteTextures(1, &e.texture);
+}
+
+size_t gn_tile_cache::tile_bytes() const
+{
+    // GL_RGBA32F, matching the chain textures
+    return 4 * sizeof(float) * tile_size_ * tile_size_;
+}
+
+GLuint gn_tile_cache::find(const gn_tile_key &key)
+{
+    auto it = index_.find(key);
+    if (it == index_.end())
+        return 0;
+
+    entries_.splice(entries_.begin(), entries_, it->second);
+    return it->second->texture;
+}
+
+GLuint gn_tile_cache::insert(const gn_tile_key &key)
+{
+    GLuint texture;
+
+    if (entries_.size() < capacity_)
+    {
+        gl_call(glCreateTextures, GL_TEXTURE_2D, 1, &texture);
+        gl_call(glTextureStorage2D, texture, 1, GL_RGBA32F, tile_size_, tile_size_);
+    }
+    else
+    {
+        // Evict the least recently used tile
+        auto &lru(entries_.back());
+        texture = lru.texture;
+        index_.erase(lru.key);
+        entries_.pop_back();
+    }
+
+    entries_.push_front(entry{key, texture});
+    index_.emplace(key, entries_.begin());
+    return texture;
+}
+
+static int64_t floor_div(int64_t a, int64_t b)
+{
+    return a / b - ((a % b != 0) && ((a < 0) != (b < 0)));
+}
+
+// Value of a definition as gn_perf_ctx resolves it, where the first one wins
+static bool find_define(const std::vector<std::string> &defines, const std::string &name, std::string &value)
+{
+    for (const auto &definition : defines)
+    {
+        auto eq_sign(definition.find("="));
+        std::string key(definition, 0, eq_sign);
+        std::transform(key.begin(), key.end(), key.begin(), ::toupper);
+
+        if (key == name)
+        {
+            value = eq_sign == std::string::npos ? std::string() : definition.substr(eq_sign + 1);
+            return true;
+        }
+    }
+
+    return false;
+}
+
+// Parses a definition value that is an integer constant
+static bool parse_int(const std::string &value, long &result)
+{
+    char *end;
+    errno = 0;
+    result = std::strtol(value.c_str(), &end, 10);
+    return !value.empty() && *end == '\0' && errno == 0;
+}
+
+gn_tile_renderer::gn_tile_renderer(int width, int height, std::vector<std::string> defines, const std::string &lut_path,
+                                   int tile_size, size_t cache_bytes)
+    : tile_ctx_(),
+    cache_(tile_size, cache_bytes),
+    shader_(0),
+    dynamic_(false),
+    period_x_(0.),
+    period_y_(0.),
+    scratch_(0),
+    read_fbo_(0),
+    timestamps_(),
+    hits(0),
+    misses(0),
+    elapsed_time(0)
+{
+    // The tiles are windows on the full-size noise field, user definitions
+    // take precedence over these
+    defines.emplace_back("VIEWPORT");
+    defines.emplace_back("WIDTH=" + std::to_string(width));
+    defines.emplace_back("HEIGHT=" + std::to_string(height));
+
+    tile_ctx_ = std::make_unique<gn_perf_ctx>(tile_size, tile_size, defines, false, lut_path);
+    shader_ = std::hash<std::string>()(tile_ctx_->identifier);
+
+    std::string value;
+    long seed;
+    dynamic_ = find_define(defines, "RANDOM_SEED", value) && !parse_int(value, seed);
+
+    // The field is periodic with TILE_COUNT.x * _TILE_SIZE on both axes,
+    // LOD_SCALE is left out since it scales RESOLUTION by a float
+    long field_width, field_height, tile_x, tile_y;
+    if (!find_define(defines, "LOD_SCALE", value) &&
+        find_define(defines, "WIDTH", value) && parse_int(value, field_width) &&
+        find_define(defines, "HEIGHT", value) && parse_int(value, field_height))
+    {
+        bool known = true;
+        if (find_define(defines, "TILE_SIZE", value))
+        {
+            known = parse_int(value, tile_x);
+            tile_y = tile_x;
+        }
+        else
+        {
+            tile_x = field_width / 3;
+            tile_y = field_height / 3;
+        }
+
+        if (find_define(defines, "KHALF", value))
+        {
+            tile_x *= 2;
+            tile_y *= 2;
+        }
+
+        if (known && tile_x > 0 && tile_y > 0 && field_width / tile_x > 0)
+        {
+            period_x_ = static_cast<double>(field_width / tile_x * tile_x);
+            period_y_ = static_cast<double>(field_width / tile_x * tile_y);
+        }
+    }
+
+    if (period_x_ == 0.)
+        log::shadertoy()->warn("Could not derive the noise field period, the viewport will not wrap");
+
+    if (dynamic_)
+    {
+        log::shadertoy()->info("RANDOM_SEED is not a constant, tiles will not be cached");
+        gl_call(glCreateTextures, GL_TEXTURE_2D, 1, &scratch_);
+        gl_call(glTextureStorage2D, scratch_, 1, GL_RGBA32F, tile_size, tile_size);
+    }
+
+    gl_call(glCreateFramebuffers, 1, &read_fbo_);
+
+    // Timestamps rather than a time elapsed query, which cannot be nested
+    // with the one of the tile chain
+    gl_call(glCreateQueries, GL_TIMESTAMP, 2, timestamps_);
+
+    log::shadertoy()->info("Initialized tile cache, {} tiles of {}x{}", cache_bytes / cache_.tile_bytes(), tile_size, tile_size);
+}
+
+gn_tile_renderer::~gn_tile_renderer()
+{
+    glDeleteQueries(2, timestamps_);
+    glDeleteFramebuffers(1, &read_fbo_);
+    if (scratch_)
+        glDeleteTextures(1, &scratch_);
+}
+
+void gn_tile_renderer::wrap(double &x, double &y) const
+{
+    if (period_x_ > 0.)
+    {
+        x -= period_x_ * std::floor(x / period_x_);
+        y -= period_y_ * std::floor(y / period_y_);
+    }
+    else
+    {
+        // The noise field starts at the origin
+        x = std::max(x, 0.);
+        y = std::max(y, 0.);
+    }
+}
+
+void gn_tile_renderer::render(double x, double y, int level, int width, int height, int frame, double time)
+{
+    hits = misses = 0;
+
+    gl_call(glQueryCounter, timestamps_[0], GL_TIMESTAMP);
+
+    const int64_t ts = cache_.tile_size();
+    const double scale = std::ldexp(1., level);
+
+    // Viewport origin, in pixels of the current level
+    int64_t ox = static_cast<int64_t>(std::floor(x / scale)),
+            oy = static_cast<int64_t>(std::floor(y / scale));
+
+    for (int64_t ty = floor_div(oy, ts); ty <= floor_div(oy + height - 1, ts); ++ty)
+    {
+        for (int64_t tx = floor_div(ox, ts); tx <= floor_div(ox + width - 1, ts); ++tx)
+        {
+            gn_tile_key key{tx, ty, level, shader_};
+            GLuint texture = dynamic_ ? 0 : cache_.find(key);
+
+            if (texture)
+            {
+                hits++;
+            }
+            else
+            {
+                misses++;
+
+                // Per-frame tiles would only evict reusable ones
+                texture = dynamic_ ? scratch_ : cache_.insert(key);
+
+                // Tile origin and scale, in noise pixels
+                auto &state(tile_ctx_->context.state());
+                state.get<shadertoy::iMouse>() = glm::vec4(tx * ts * scale, ty * ts * scale, scale, 0.);
+                state.get<shadertoy::iFrame>() = frame;
+                state.get<shadertoy::iTime>() = time;
+
+                gl_call(glViewport, 0, 0, ts, ts);
+                tile_ctx_->context.render(tile_ctx_->chain);
+
+                auto output = tile_ctx_->chain.members().front()->output();
+                assert(output);
+                gl_call(glCopyImageSubData, GLuint(*output), GL_TEXTURE_2D, 0, 0, 0, 0,
+                        texture, GL_TEXTURE_2D, 0, 0, 0, 0, ts, ts, 1);
+            }
+
+            // Place the tile in the default framebuffer, clipped by GL
+            GLint dx = static_cast<GLint>(tx * ts - ox),
+                  dy = static_cast<GLint>(ty * ts - oy);
+
+            gl_call(glNamedFramebufferTexture, read_fbo_, GL_COLOR_ATTACHMENT0, texture, 0);
+            gl_call(glBlitNamedFramebuffer, read_fbo_, 0,
+                    0, 0, ts, ts,
+                    dx, dy, dx + ts, dy + ts,
+                    GL_COLOR_BUFFER_BIT, GL_NEAREST);
+        }
+    }
+
+    gl_call(glQueryCounter, timestamps_[1], GL_TIMESTAMP);
+
+    // Waits for the frame to complete
+    GLuint64 start, end;
+    gl_call(glGetQueryObjectui64v, timestamps_[0], GL_QUERY_RESULT, &start);
+    gl_call(glGetQueryObjectui64v, timestamps_[1], GL_QUERY_RESULT, &end);
+    elapsed_time = end - start;
+}
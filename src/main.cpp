@@ -3,6 +3,8 @@
 
 #include <boost/filesystem.hpp>
 #include <boost/program_options.hpp>
+#include <algorithm>
+#include <cmath>
 #include <iostream>
 #include <iomanip>
 
@@ -16,6 +18,8 @@
 #include "gn_perf_config.hpp"
 #include "stat_acc.hpp"
 #include "gn_glfw.hpp"
+#include "gn_readback.hpp"
+#include "gn_tile_cache.hpp"
 #include "hash.hpp"
 
 static volatile int sigint_signaled = 0;
@@ -42,6 +46,63 @@ template <typename inttype> inttype topx(float value, float k = 1.f)
 	return static_cast<inttype>(scaled_value);
 }
 
+struct gn_view
+{
+    // Origin of the viewport, in noise pixels
+    double x, y;
+    // Zoom level, 2^level noise pixels per screen pixel
+    int level;
+
+    bool dragging;
+    double cursor_x, cursor_y;
+    bool zoom_in, zoom_out;
+};
+
+void update_view(GLFWwindow *window, const gn_tile_renderer &tiles, gn_view &view, double pan_x, double pan_y, int width, int height)
+{
+    double scale = std::ldexp(1., view.level);
+
+    // Drag with the left mouse button
+    double cx, cy;
+    glfwGetCursorPos(window, &cx, &cy);
+    bool dragging = glfwGetMouseButton(window, GLFW_MOUSE_BUTTON_LEFT) == GLFW_PRESS;
+    if (dragging && view.dragging)
+    {
+        // Window coordinates have y pointing down
+        view.x -= (cx - view.cursor_x) * scale;
+        view.y += (cy - view.cursor_y) * scale;
+    }
+    view.dragging = dragging;
+    view.cursor_x = cx;
+    view.cursor_y = cy;
+
+    // Arrow keys, then automatic panning
+    double step = 8. * scale;
+    view.x += step * ((glfwGetKey(window, GLFW_KEY_RIGHT) == GLFW_PRESS) - (glfwGetKey(window, GLFW_KEY_LEFT) == GLFW_PRESS));
+    view.y += step * ((glfwGetKey(window, GLFW_KEY_UP) == GLFW_PRESS) - (glfwGetKey(window, GLFW_KEY_DOWN) == GLFW_PRESS));
+    view.x += pan_x * scale;
+    view.y += pan_y * scale;
+
+    // Zoom around the center of the window on key press
+    bool zoom_in = glfwGetKey(window, GLFW_KEY_PAGE_UP) == GLFW_PRESS,
+         zoom_out = glfwGetKey(window, GLFW_KEY_PAGE_DOWN) == GLFW_PRESS;
+    int level = view.level + (zoom_out && !view.zoom_out) - (zoom_in && !view.zoom_in);
+    level = std::min(std::max(level, -4), 16);
+    view.zoom_in = zoom_in;
+    view.zoom_out = zoom_out;
+
+    if (level != view.level)
+    {
+        double new_scale = std::ldexp(1., level);
+        view.x += .5 * width * (scale - new_scale);
+        view.y += .5 * height * (scale - new_scale);
+        view.level = level;
+    }
+
+    // Keeps the origin within float precision of the iMouse uniform
+    tiles.wrap(view.x, view.y);
+}
+
 void write_output(const std::string &output_param, const stat_acc &time_ms, const std::shared_ptr<shadertoy::members::basic_member> &last_result, int width, int height, const std::string &include_stat, bool raw_output, const std::string &identifier)
 {
     auto output_basename = (output_param == "auto") ? identifier : output_param;
@@ -94,8 +155,10 @@ int main(int argc, char *argv[])
 {
     int width, height, size;
     long long samples, warmup_samples;
-    bool st_silent, all_silent, raw_output, sync_anyways, test_mode;
-    std::string include_stat, output, lut_path;
+    int stream_slots, cache_size, cache_tile, zoom;
+    double pan_x, pan_y;
+    bool st_silent, all_silent, raw_output, sync_anyways, test_mode, viewport;
+    std::string include_stat, output, lut_path, stream, stream_format;
     std::vector<std::string> defines;
 
     po::options_description gn_desc("Noise options");
@@ -121,6 +184,10 @@ int main(int argc, char *argv[])
          "\t - KHALF: use a half-size kernel, evaluate only 4 cells\n"
          "\t - KKAISER_BESSEL: use the Kaiser-Bessel window for the kernel\n"
          "\t - RANDOM_PHASE: use random phase kernel\n"
+         "\t - LOD: prefilter the kernel for the pixel footprint\n"
+         "\t - LOD_SCALE=s: render the full-size noise minified by s (implies LOD)\n"
+         "\t - LOD_SIGMA=k: pixel filter width, in footprints (defaults to 0.5)\n"
+         "\t - LOD_CUTOFF=a: skip splats when attenuated below a (defaults to 1e-3)\n"
          "\t - WEIGHTS=weight: type of the random weights to use:\n"
          "\t   - WEIGHTS_UNIFORM: uniform [-1, 1] weights (default)\n"
          "\t   - WEIGHTS_BERNOULLI: Bernoulli {-1, 1} weights\n"
@@ -149,6 +216,20 @@ int main(int argc, char *argv[])
         ("raw,r", po::bool_switch(&raw_output)->default_value(false), "Raw value output (no header nor size). Only applies to final output")
         ("sync,S", po::bool_switch(&sync_anyways)->default_value(false), "Force vsync even if measuring performance")
         ("test,T", po::bool_switch(&test_mode)->default_value(false), "TAP self-test mode")
+        ("stream", po::value(&stream)->default_value(""), "Publish every rendered frame:\n"
+         "\t * shm:/name: ring buffer in a POSIX shared memory object\n"
+         "\t * pipe:path: raw frames written to a FIFO or file\n"
+         "See include/gn_stream.hpp for the layout")
+        ("stream-slots", po::value(&stream_slots)->default_value(4), "Number of frames in the shared memory ring buffer")
+        ("stream-format", po::value(&stream_format)->default_value("rgba32f"), "Format of the streamed frames (rgba8, rgba32f)")
+        ("viewport,V", po::bool_switch(&viewport)->default_value(false), "Render a viewport on the noise field from cached tiles\n"
+         "Pan with the mouse or the arrow keys, zoom with page up/down.\n"
+         "Use -DWIDTH and -DHEIGHT to set the size of the noise field")
+        ("cache-size", po::value(&cache_size)->default_value(256), "Tile cache size, in MiB")
+        ("cache-tile", po::value(&cache_tile)->default_value(256), "Tile cache tile size, in pixels")
+        ("zoom", po::value(&zoom)->default_value(0), "Initial viewport zoom level, 2^zoom noise pixels per screen pixel")
+        ("pan-x", po::value(&pan_x)->default_value(0.), "Viewport panning per frame, in screen pixels")
+        ("pan-y", po::value(&pan_y)->default_value(0.), "Viewport panning per frame, in screen pixels")
         ("help,h", "Show this help message");
 
     desc.add(gn_desc);
@@ -195,6 +276,18 @@ int main(int argc, char *argv[])
         width = height = size;
     }
 
+    if (viewport && (!stream.empty() || !output.empty()))
+    {
+        std::cerr << "--stream and --output are not supported with --viewport" << std::endl;
+        return 1;
+    }
+
+    if (viewport && (cache_tile <= 0 || cache_size <= 0))
+    {
+        std::cerr << "--cache-tile and --cache-size must be positive" << std::endl;
+        return 1;
+    }
+
     if (warmup_samples < 0 && samples != 0)
     {
         warmup_samples = 64;
@@ -269,9 +362,33 @@ int main(int argc, char *argv[])
         // Set the resize callback
         glfwSetWindowUserPointer(window, &ctx);
 
+        // Frame streaming
+        std::unique_ptr<gn_readback> readback;
+        if (!stream.empty())
+        {
+            auto format = gn_stream_parse_format(stream_format);
+            auto frame_size = gn_stream_pixel_size(format) * ctx.render_size.width * ctx.render_size.height;
+
+            log::shadertoy()->info("Streaming frames to {}", stream);
+            readback = std::make_unique<gn_readback>(gn_stream_sink::create(stream, frame_size, stream_slots),
+                                                     format, ctx.identifier);
+        }
+
+        // Tile cache for the viewport
+        std::unique_ptr<gn_tile_renderer> tiles;
+        gn_view view{0., 0., zoom, false, 0., 0., false, false};
+        if (viewport)
+        {
+            tiles = std::make_unique<gn_tile_renderer>(width, height, defines, lut_path, cache_tile,
+                                                       static_cast<size_t>(cache_size) << 20);
+        }
+
         stat_acc time_ms;
 
-        fprintf(stderr, "%8s\t%10s\t%9s\t%13s\t%4s\t%4s\t%9s\n", "frame", "time_ms", "fps", "mpx_s", "wh_px", "ch_px", "stddevp");
+        fprintf(stderr, "%8s\t%10s\t%9s\t%13s\t%4s\t%4s\t%9s", "frame", "time_ms", "fps", "mpx_s", "wh_px", "ch_px", "stddevp");
+        if (tiles)
+            fprintf(stderr, "\t%9s\t%9s", "hit%", "cache_mb");
+        fprintf(stderr, "\n");
 
         signal(SIGINT, sigint_handler);
 
@@ -284,16 +401,31 @@ int main(int argc, char *argv[])
             context.state().get<shadertoy::iTime>() = t;
             context.state().get<shadertoy::iFrame>() = uhash(frameCount);
 
-            // Set viewport
-            // This is not necessary when the last pass is rendering to a
-            // texture and it is followed by a screen_member, which calls
-            // glViewport. In this example, we render directly to the
-            // default framebuffer, so we need to set the viewport
-            // ourselves.
-            gl_call(glViewport, 0, 0, ctx.render_size.width, ctx.render_size.height);
+            if (tiles)
+            {
+                // Render the viewport, only evaluating the tiles that are
+                // not cached yet
+                update_view(window, *tiles, view, pan_x, pan_y, ctx.render_size.width, ctx.render_size.height);
+                tiles->render(view.x, view.y, view.level, ctx.render_size.width, ctx.render_size.height,
+                              uhash(frameCount), t);
+            }
+            else
+            {
+                // Set viewport
+                // This is not necessary when the last pass is rendering to a
+                // texture and it is followed by a screen_member, which calls
+                // glViewport. In this example, we render directly to the
+                // default framebuffer, so we need to set the viewport
+                // ourselves.
+                gl_call(glViewport, 0, 0, ctx.render_size.width, ctx.render_size.height);
+
+                // Render the swap chain
+                context.render(chain);
+            }
 
-            // Render the swap chain
-            context.render(chain);
+            // Queue the frame for streaming
+            if (readback)
+                readback->push(frameCount, ctx.chain.members().front(), ctx.render_size.width, ctx.render_size.height);
 
             // Buffer swapping
             glfwSwapBuffers(window);
@@ -310,7 +442,9 @@ int main(int argc, char *argv[])
             if (warmup_samples <= 0 && pstate_ok)
             {
                 // Get the render time for the frame
-                auto elapsed_time = ctx.image_buffer->elapsed_time();
+                // With the tile cache, this covers the evaluated tiles and
+                // the composition of the whole viewport
+                auto elapsed_time = tiles ? tiles->elapsed_time : static_cast<uint64_t>(ctx.image_buffer->elapsed_time());
                 auto pixel_count = static_cast<double>(ctx.render_size.width * ctx.render_size.height);
 
                 // 0 should not be measured by the driver
@@ -322,14 +456,19 @@ int main(int argc, char *argv[])
                     (samples < 0 && time_ms.sample_count() >= 16 && (stddevp * 1e4) < -samples))
                     glfwSetWindowShouldClose(window, 1);
 
-                fprintf(stderr, "%8d\t%10lf\t%8.2lf\t%12.2lf\t%4d\t%4d\t%8.2lf\n",
+                fprintf(stderr, "%8d\t%10lf\t%8.2lf\t%12.2lf\t%4d\t%4d\t%8.2lf",
                         frameCount,
                         elapsed_time / 1e6,
-                        1.0e9 / elapsed_time,
-                        1.0e3 * pixel_count / elapsed_time,
+                        elapsed_time != 0 ? 1.0e9 / elapsed_time : 0.,
+                        elapsed_time != 0 ? 1.0e3 * pixel_count / elapsed_time : 0.,
                         ctx.render_size.width,
                         ctx.render_size.height,
                         stddevp * 1e2);
+                if (tiles)
+                    fprintf(stderr, "\t%8.2lf\t%8.2lf",
+                            1.0e2 * tiles->hits / std::max(1, tiles->hits + tiles->misses),
+                            tiles->cache().memory_used() / 1048576.);
+                fprintf(stderr, "\n");
             }
             else
             {
@@ -343,6 +482,10 @@ int main(int argc, char *argv[])
 
         fprintf(stderr, "\n");
 
+        // Publish the frames still in flight
+        if (readback)
+            readback->flush();
+
         // Write output data
         if (!output.empty())
         {
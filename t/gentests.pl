@@ -16,21 +16,27 @@ for my $points (qw/WHITE STRATIFIED JITTERED HEX_JITTERED GRID HEX_GRID/) {
     for my $weights (qw/UNIFORM BERNOULLI NONE RANDPHASE/) {
         for my $prng (qw/LCG XORSHIFT XOROSHIRO HASH/) {
             for my $kernel (qw/COS SIN/) {
-                my $fn = sprintf("%03d_%s-%s-%s-%s",
-                    $i++, map({ lc } $points, $weights, $prng, $kernel));
-                say $fn;
+                for my $lod (qw/NONE LOD SCALE KHALF LUT/) {
+                    my $fn = sprintf("%03d_%s-%s-%s-%s-%s",
+                        $i++, map({ lc } $points, $weights, $prng, $kernel, $lod));
+                    say $fn;
 
-                open my $fh, '>', "$FindBin::Bin/$fn.t";
-                $tt->process("test.tt", {
-                        points => $points,
-                        weights => $weights eq 'RANDPHASE' ? 'NONE' : $weights,
-                        prng => $prng,
-                        ksin => $kernel eq 'SIN',
-                        fn => $fn,
-                        randphase => $weights eq 'RANDPHASE',
-                    }, $fh) || die $tt->error(), "\n";
-                close $fh;
-                chmod 0755, "$FindBin::Bin/$fn.t";
+                    open my $fh, '>', "$FindBin::Bin/$fn.t";
+                    $tt->process("test.tt", {
+                            points => $points,
+                            weights => $weights eq 'RANDPHASE' ? 'NONE' : $weights,
+                            prng => $prng,
+                            ksin => $kernel eq 'SIN',
+                            fn => $fn,
+                            randphase => $weights eq 'RANDPHASE',
+                            lod => $lod ne 'NONE',
+                            lod_scale => $lod eq 'SCALE',
+                            khalf => $lod eq 'KHALF',
+                            lut => $lod eq 'LUT',
+                        }, $fh) || die $tt->error(), "\n";
+                    close $fh;
+                    chmod 0755, "$FindBin::Bin/$fn.t";
+                }
             }
         }
     }